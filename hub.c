@@ -7,27 +7,58 @@ Student Number:
 
 Description:  This program creates the station processes
      (A, B, C, and D) and then acts as token ring hub.
+     The thread listening on the first T-pair pipe also acts as
+     the active monitor of the ring (see activeMonitor()).
+
+Usage: hub [-f n]
+     -f n  fault injection: every n-th read on the other T-pair
+           pipes is lost or has its source address garbled.
 -------------------------------------------------------------*/
+#define _GNU_SOURCE        // for ppoll()
 #include <stdio.h>
 #include <unistd.h>
 #include <pthread.h>
 #include <string.h>
 #include <stdlib.h>
+#include <poll.h>
+#include <time.h>
+#include "tokRing.h"
 
 #define OK 1
 #define PROGRAM_STN "stn"  // The program that acts like a station
 #define MAX_STNS 10        // Maximum number of stations
+#define LOST_ROTATIONS 2          // Rotations without a token or frame - token is lost
+#define ROT_TIMEOUT_FACTOR 4      // Marker lost after this times the longest recent rotation
+#define ROT_TIMEOUT_MIN_US 200    // but never before this time (us)
+#define ROT_TIMEOUT_MAX_US 50000  // Doubled when a marker comes back late, up to this time (us)
+#define MARKER_MAX 18             // Longest marker frame, with its '\0' (see buildMarker())
 // Note that the terms reception and transmission are relatif to the station and not the hub
 // Note that the descriptors at the same index in the two arrays are related to the adjacent stations,
 // for example, fdsRec[2] and fdsTran[2] contain the fds of the pipes connected to adjacent stations
 //                                       in the ring.
 int fdsRec[MAX_STNS+1];    // file descriptors for writing ends (reception)
 int fdsTran[MAX_STNS+1];   // file descriptors for reading ends (transmission)
+int faultEvery = 0;        // fault injection period on T-pair reads (0 - no faults)
+
+// Active monitor statistics - updated only by the monitor thread
+int monTokensLost = 0;     // token regenerated after rotations without a token
+int monDupTokens = 0;      // duplicate tokens purged
+int monMarkersLost = 0;    // rotation markers that did not come back in time (presumed lost)
+int monOrphans = 0;        // orphan frames purged
+int monGarbled = 0;        // bytes purged that were not part of a frame
+long monRecoveryUs = 0;    // total time the ring was without a token
+long monRecoveryMaxUs = 0; // longest time the ring was without a token
+long monRotMaxUs = 0;      // longest rotation
 
 /* Prototypes */
 void createStation(char *);
 void hubThreads();
 void *listenTran(void *);
+void *activeMonitor(void *);
+int tokenLost(char *, int *, long *, long);
+int closeRotation(char *, int, int *, int *, int *, long *);
+int buildMarker(char *, int);
+long nowUs(void);
 
 /*-------------------------------------------------------------
 Function: main
@@ -44,6 +75,14 @@ int main(int ac, char **av)
    	int ix;      // Array index
    	int first;   // First entry
 
+   	if(ac == 3 && strcmp(av[1],"-f") == 0)
+		faultEvery = atoi(av[2]);
+   	else if(ac != 1)
+   	{
+		fprintf(stderr,"Usage: hub [-f n]\n");
+		exit(-1);
+   	}
+
    	// Initialization
    	fdsRec[0] = -1; // empty list
    	fdsTran[0] = -1; // empty list
@@ -138,7 +177,9 @@ void createStation(char *fileConfig)
 Function: hubThreads
 Description:
    Create 4 threads to listen on each T-pair pipe (i.e to the
-   fd's in fdsTran) with the function listenTran.
+   fd's in fdsTran) with the function listenTran.  The first
+   thread runs activeMonitor() instead, which also issues the
+   initial token.
    Once the threads have been created, sleep to allow all messages
    to be exchanged and then cancel (terminate) the threads.
 --------------------------------------------------------------*/
@@ -157,13 +198,11 @@ void hubThreads()
 	for(i = 0; i < 4; i++){
 		params[i][1] =  fdsRec[i]; //add rec fd to params
 		params[i][0] =  fdsTran[i]; //add tran fd to params
-		pthread_create(&tid[i],&attr,listenTran,params[i]); //create thread
+		if(i == 0) //first link is the active monitor - it writes the token
+			pthread_create(&tid[i],&attr,activeMonitor,params[i]);
+		else
+			pthread_create(&tid[i],&attr,listenTran,params[i]); //create thread
 	}
-
-   // Write Token to a pipe
-	char buf[10];
-	strcpy(buf, "^"); //send token symbol
-	write(fdsRec[0],buf,1);
 	
    	// Sleep a bit
    	sleep(15);
@@ -172,6 +211,14 @@ void hubThreads()
 	for(i= 0; i < 4; i ++){
 		pthread_cancel(tid[i]); // bye-bye
 	}
+	for(i= 0; i < 4; i ++){
+		pthread_join(tid[i],NULL);
+	}
+	fprintf(stderr,"hub: active monitor: %d token(s) lost, %d duplicate token(s) purged, "
+	        "%d marker(s) overdue, %d orphan frame(s) purged, %d garbled byte(s) purged, "
+	        "recovery %ld us total, %ld us max, longest rotation %ld us\n",
+	        monTokensLost,monDupTokens,monMarkersLost,monOrphans,monGarbled,
+	        monRecoveryUs,monRecoveryMaxUs,monRotMaxUs);
 }
 
 /*-------------------------------------------------------------------
@@ -190,6 +237,8 @@ void *listenTran(void *fdPairPtr)
    int fdSend = fdPair[1];      // Get the fd on which to send
 	int num;                      // value returned by read (num of bytes read)
    char buffer[BUFSIZ];          // buffer for reading data
+   char *pt;                     // to find a frame when injecting faults
+   int nReads = 0;               // number of reads - for fault injection
    int i;
   
    while(1)  // a loop
@@ -213,7 +262,292 @@ void *listenTran(void *fdPairPtr)
        // Following lines can be used for debugging
        //printf("hub: received frame from %d >%s<\n",fdListen,buffer);
        //printf("hub: transmitting frame to %d >%s<\n",fdsRec[i],buffer);
+       if(faultEvery > 0 && ++nReads % faultEvery == 0) // inject a fault
+       {
+          pt = strchr(buffer,STX);
+          if(pt == NULL || (nReads/faultEvery) % 2 == 0)
+             continue;             // lose everything that was read
+          if(strlen(pt) > SRC_POS)
+             pt[SRC_POS] = '?';    // garble the source - no station removes the frame
+       }
        write(fdSend,buffer,strlen(buffer));
      }
    }
 }
+
+/*-------------------------------------------------------------------
+Function: activeMonitor
+
+Description: 
+   Runs in place of listenTran() on the first T-pair pipe and acts as
+   the active monitor of the ring (as in 802.5):
+   - Issues the initial token.
+   - Circulates a rotation marker frame (from and to MONITOR_ID, the
+     message is a sequence number).  Each time it comes back a rotation
+     is complete and a new marker is sent.  Rotations are counted with
+     the marker rather than with a fixed timer.
+   - The token passes the monitor exactly once per rotation, either as
+     the token or as the frame of the station holding it (a frame on
+     its first time around).  A token seen after the token or a frame
+     in the same rotation is a duplicate and is purged, unless half of
+     the last rotation has elapsed since the marker was sent: the
+     marker is then presumed lost and the token closes the rotation
+     instead, a new marker being sent behind it.  Rotation times vary
+     too much to wait for a full one, and a real duplicate is within
+     half a rotation of either the marker or the other token, so it
+     is still purged in one of the next rotations.
+   - If LOST_ROTATIONS rotations complete without the token or a frame,
+     the token is considered lost and a new one is issued.  Only
+     rotations seen to complete (the marker came back) are counted.
+   - If the marker does not come back within ROT_TIMEOUT_FACTOR times
+     the longest recent rotation (at least ROT_TIMEOUT_MIN_US), it is
+     considered lost and a new marker with the next sequence number is
+     sent.  Any other frame addressed to MONITOR_ID (a late marker or
+     a marker with a garbled source) is purged.  A late marker shows
+     that the ring is slower than the timeout, which is then doubled
+     (up to ROT_TIMEOUT_MAX_US); markers that were lost do not, so
+     the timeout stays short when faults destroy them.  When nothing
+     comes back, new markers are sent until rotations complete again
+     and the token can be regenerated.
+   - Sets the monitor mark of each frame passing by.  A frame that
+     arrives with its mark already set has gone around the ring once
+     without being removed by its source (e.g. the source address was
+     garbled or the source is gone); it is purged.  If the token was
+     lost with it, it is regenerated as above.
+   - Purges data that is not part of a frame or a token.
+   The time from the last token seen to the return of a regenerated
+   token is recorded as the recovery time.
+-------------------------------------------------------------------*/
+void *activeMonitor(void *fdPairPtr)
+{
+   int *fdPair = (int *) fdPairPtr;
+   int fdListen = fdPair[0];     // Get the fd on which to listen
+   int fdSend = fdPair[1];       // Get the fd on which to send
+   int num;                      // value returned by read/poll
+   char buffer[BUFSIZ];          // data read, starting with an incomplete frame
+   char out[BUFSIZ+1+MARKER_MAX]; // data to forward - plus a new token and marker
+   int len = 0;                  // number of bytes in buffer
+   int outLen;                   // number of bytes in out
+   char *pt, *end;               // to navigate the buffer
+   struct pollfd pfd;
+   int markSeq = 0;              // sequence number of the marker out
+   long markSent;                // time the marker was sent (us)
+   long scanAt;                  // time the data read is scanned (us)
+   long maxRot = 0;              // longest recent rotation (us) - decays every rotation
+   long rot = 0;                 // time of the last rotation (us)
+   int tokens = 0;               // tokens and frames seen during the current rotation
+   int noToken = 0;              // consecutive rotations without a token or frame
+   long lastToken;               // time a token was last seen (us)
+   long lostAt = 0;              // time of the last token before a loss (0 - no loss)
+   long wait;                    // time after which the marker is lost (us)
+   long timeout;                 // time left before the marker is lost (us)
+   struct timespec ts;           // timeout for ppoll()
+   long recovery;                // time without a token (us)
+
+   pfd.fd = fdListen;
+   pfd.events = POLLIN;
+   out[0] = SYN;                 // initial token
+   outLen = 1 + buildMarker(out+1,markSeq);
+   write(fdSend,out,outLen);
+   markSent = lastToken = nowUs();
+
+   while(1)  // a loop
+   {
+     wait = ROT_TIMEOUT_FACTOR*maxRot;
+     if(wait < ROT_TIMEOUT_MIN_US) wait = ROT_TIMEOUT_MIN_US;
+     timeout = markSent + wait - nowUs();
+     if(timeout < 0) timeout = 0;
+     ts.tv_sec = timeout/1000000L;
+     ts.tv_nsec = (timeout%1000000L)*1000L;
+     num = ppoll(&pfd,1,&ts,NULL);
+     if(num == 0) // marker did not come back - start a new rotation
+     {
+        monMarkersLost++;
+        monGarbled += len;
+        len = 0;                 // purge an incomplete frame
+        if(tokens > 0) noToken = 0;  // the rotation was not seen to complete - not counted
+        tokens = 0;
+        outLen = buildMarker(out,++markSeq);
+        write(fdSend,out,outLen);
+        markSent = nowUs();
+        continue;
+     }
+     if(num > 0)
+        num = read(fdListen,buffer+len,BUFSIZ-1-len);
+     if(num == -1) // error in reading 
+     {
+        sprintf(out,"Fatal error in reading on fd %d (%d)",fdListen,getpid());
+	perror(out);  			/* writes on standard error */
+	break;  			/* break the loop */
+     }
+     else if(num == 0) /* other end of pipe closed - should not happen */
+     {
+	sprintf(out,"Pipe closed (%d)\n",getpid());
+        write(2,out,strlen(out)); 	// write to standard error
+	break;  			/* break the loop */
+     }
+     len += num;
+     buffer[len] = '\0';          // terminate the string
+
+     // Scan the tokens and frames, copying those to forward to out.  A marker
+     // sent during the scan is never overdue, so at most one marker is added.
+     outLen = 0;
+     scanAt = nowUs();
+     pt = buffer;
+     while(*pt != '\0')
+     {
+        if(*pt == SYN) // the token
+        {
+           if(tokens > 0 && scanAt - markSent <= rot/2) // token already seen in this rotation - duplicate
+           {
+              monDupTokens++;
+              fprintf(stderr,"hub: active monitor: purged duplicate token\n");
+           }
+           else
+           {
+              tokens++;
+              lastToken = nowUs();
+              if(lostAt != 0) // new token is back - ring has recovered
+              {
+                 recovery = lastToken - lostAt;
+                 monRecoveryUs += recovery;
+                 if(recovery > monRecoveryMaxUs) monRecoveryMaxUs = recovery;
+                 fprintf(stderr,"hub: active monitor: ring recovered in %ld us\n",recovery);
+                 lostAt = 0;
+              }
+              out[outLen++] = SYN;
+              if(tokens > 1) // marker overdue - the token closes the rotation
+                 outLen = closeRotation(out,outLen,&tokens,&noToken,&markSeq,&markSent);
+           }
+           pt++;
+        }
+        else if(*pt == STX) // a frame
+        {
+           end = strchr(pt,ETX);
+           if(end == NULL) break;  // incomplete frame - wait for the rest
+           if(end - pt < MSG_POS)  // too short to be a frame
+           {
+              monGarbled += end - pt + 1;
+           }
+           else if(pt[DST_POS] == MONITOR_ID) // marker
+           {
+              // rotation complete (else late or garbled marker - purged)
+              if(pt[SRC_POS] == MONITOR_ID && atoi(pt+MSG_POS) == markSeq)
+              {
+                 rot = nowUs() - markSent;
+                 maxRot -= maxRot/8;
+                 if(rot > maxRot) maxRot = rot;
+                 if(rot > monRotMaxUs) monRotMaxUs = rot;
+                 if(tokens == 0) noToken++;
+                 else noToken = 0;
+                 tokens = 0;
+                 if(noToken >= LOST_ROTATIONS) // token lost
+                    outLen += tokenLost(out+outLen,&noToken,&lostAt,lastToken);
+                 outLen += buildMarker(out+outLen,++markSeq);
+                 markSent = nowUs();
+              }
+              else if(pt[SRC_POS] == MONITOR_ID && wait < ROT_TIMEOUT_MAX_US)
+                 maxRot = 2*wait/ROT_TIMEOUT_FACTOR;  // came back late - wait twice as long
+           }
+           else if(pt[MON_POS] == MON_SET) // second time around - orphan
+           {
+              monOrphans++;
+              fprintf(stderr,"hub: active monitor: purged orphan frame >%.*s<\n",
+                      (int) (end - pt + 1),pt);
+           }
+           else
+           {
+              tokens++;  // frame sent by the token holder
+              pt[MON_POS] = MON_SET;
+              memcpy(out+outLen,pt,end - pt + 1);
+              outLen += end - pt + 1;
+              if(tokens > 1 && scanAt - markSent > rot/2) // marker overdue - closes the rotation
+                 outLen = closeRotation(out,outLen,&tokens,&noToken,&markSeq,&markSent);
+           }
+           pt = end + 1;
+        }
+        else // not part of a frame - purge
+        {
+           monGarbled++;
+           pt++;
+        }
+     }
+     // Keep an incomplete frame for the next read (unless it cannot fit)
+     len = strlen(pt);
+     if(len >= BUFSIZ-1)
+     {
+        monGarbled += len;
+        len = 0;
+     }
+     memmove(buffer,pt,len);
+     if(outLen > 0)
+        write(fdSend,out,outLen);
+   }
+   return(NULL);
+}
+
+/*-------------------------------------------------------------------
+Function: tokenLost
+
+Description: 
+   Called by activeMonitor() when the token is lost.  Records the
+   loss, puts a new token in the buffer referenced by out and returns
+   the number of bytes added.  noTokenPtr is reset and lostAtPtr is set
+   to lastToken unless the ring is already recovering.
+-------------------------------------------------------------------*/
+int tokenLost(char *out, int *noTokenPtr, long *lostAtPtr, long lastToken)
+{
+   if(*lostAtPtr == 0) *lostAtPtr = lastToken;
+   *noTokenPtr = 0;
+   monTokensLost++;
+   fprintf(stderr,"hub: active monitor: token lost, issuing new token\n");
+   *out = SYN;
+   return(1);
+}
+
+/*-------------------------------------------------------------------
+Function: closeRotation
+
+Description: 
+   Called by activeMonitor() when the token (or the frame of its
+   holder) comes back while the marker is overdue: the marker is
+   presumed lost and the token closes the rotation.  A new marker is
+   added to the outLen bytes in out, behind the token, and the
+   rotation counters are reset.  Returns the new number of bytes in out.
+-------------------------------------------------------------------*/
+int closeRotation(char *out, int outLen, int *tokensPtr, int *noTokenPtr,
+                  int *markSeqPtr, long *markSentPtr)
+{
+   monMarkersLost++;
+   *tokensPtr = 0;
+   *noTokenPtr = 0;
+   outLen += buildMarker(out+outLen,++*markSeqPtr);
+   *markSentPtr = nowUs();
+   return(outLen);
+}
+
+/*-------------------------------------------------------------------
+Function: buildMarker
+
+Description: 
+   Builds the rotation marker frame with sequence number seq in the
+   buffer referenced by frame and returns its length.
+-------------------------------------------------------------------*/
+int buildMarker(char *frame, int seq)
+{
+   return(sprintf(frame,"%c%c%c%c%c%d%c",STX,MONITOR_ID,MONITOR_ID,MON_CLR,CPY_NONE,seq,ETX));
+}
+
+/*-------------------------------------------------------------------
+Function: nowUs
+
+Description: 
+   Returns a monotonic time in microseconds.
+-------------------------------------------------------------------*/
+long nowUs(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC,&ts);
+   return(ts.tv_sec*1000000L + ts.tv_nsec/1000L);
+}
@@ -7,27 +7,38 @@ configuration file determines the station identifer (first data line)
 and the identifier of the station to which messages are sent (second
 data line).  Other data lines in the configuration files are
 messages to be sent (lines starting with # or empty are ignored).
+Lines starting with + give the group addresses ('0' to '9') the
+station is a member of, e.g. "+12" for groups 1 and 2.  The
+destination can be a group address or * (broadcast) to send each
+message to several stations in a single ring rotation.
 
 After each message is sent the station process waits for an 
-acknowledgement (Ack message).  All communication is done using
+acknowledgement (Ack message).  If none arrives within ACK_TIMEOUT_MS
+(the message or its Ack was lost in the ring), the message is sent
+again, at most ACK_RETRIES times.  All communication is done using
 the standard input and standard output.  The station process can still
 print to the screen using the standard error. When the station process
-receives a messages, it reponds by returning an acknowledgement.
+receives a messages, it reponds by returning an acknowledgement
+(except for group messages, which are acknowledged by the token ring
+interface module with a single aggregated Ack).
 -------------------------------------------------------------*/
 #include <stdio.h>
 #include <unistd.h>
 #include "tokRing.h"
 #include <string.h>
+#include <time.h>
 
 // Some definitions
 #define MSGS_MAX 10 // Maximum number of messages
+#define ACK_TIMEOUT_MS 500 // Time to wait for an acknowledgement before sending again
+#define ACK_RETRIES 5      // Number of times a message is sent again
 #define TRUE 1
 #define FALSE 0
-#define ACKNOWLEDGMENT "Ack"
 
 // Prototypes
-void readFile(FILE *, char *, char *, char *[], char *);
+void readFile(FILE *, char *, char *, char *, char *[], char *);
 void communication(char, char, char *[]);
+long nowMs(void);
 
 /*-------------------------------------------------------------
 Function: main
@@ -45,6 +56,7 @@ int main(int ac, char **av)
 {
    char dest;                   // destination identifier
    char idStn;                  // station identificatier
+   char groups[MAX_GROUPS+1];   // group addresses the station is a member of
    char *messages[MSGS_MAX+1];  // array of pointers to messages - terminated with NULL
    char msgsBuffer[BUFSIZ];     // buffer of messages
    FILE *fp;
@@ -63,11 +75,11 @@ int main(int ac, char **av)
       }
       else
       {
-         readFile(fp, &idStn, &dest, messages, msgsBuffer);
+         readFile(fp, &idStn, &dest, groups, messages, msgsBuffer);
 	 fclose(fp);
 	 if(idStn != '\0' && dest != '\0') 
          { 
-	   initTokenRing(idStn);
+	   initTokenRing(idStn, groups);
 	   communication(idStn, dest, messages);
          } 
 	 else fprintf(stderr,"File corrupted\n");
@@ -80,30 +92,44 @@ Parameters:
 	fp	 - file pointeur
 	idStnPt  - pointeur to return station identifier
 	destPt	 - pointeur to return destination identifier
+	groups   - buffer to return the group addresses (MAX_GROUPS+1 characters)
 	msgs     - array of pointers to messages for transmission
 	msgsBuf  - pointer to buffer to store messages
 Description:
    Read all lines in the file. All empty lines and those starting with # are ignored.
+   Lines starting with +: the digits that follow are group addresses.
    First line: use the first character as the station id
    Second line: use the first character as the destination id
    Other lines: are the messages.
    (care must be taken with inserting spaces in the file).
 -------------------------------------------------------------*/
-void readFile(FILE *fp, char *idStnPt, char *destPt, char *msgs[], char *msgsBuf)
+void readFile(FILE *fp, char *idStnPt, char *destPt, char *groups, char *msgs[], char *msgsBuf)
 {
     char line[BUFSIZ];   // for reading in a line from the file
     char *pt = msgsBuf;  // pointer to add messages to the message buffer msgsBuf
+    char *gp;            // pointer to read group addresses
     int i = 0;           // index into the pointer array
+    int g = 0;           // index into groups
 
     // Some initialization
     *idStnPt = '\0';  
     *destPt = '\0';
+    groups[g] = '\0';
     msgs[i] = NULL;  // empty list
     while(fgets(line, BUFSIZ-1, fp) != NULL)
     {
        if(*line != '\n' && *line != '#' && *line != '\0')  // to ignore lines
        {
-           if(*idStnPt == '\0') // found first line
+           if(*line == '+') // group membership
+	   {
+	      for(gp = line+1; *gp >= '0' && *gp <= '9'; gp++)
+	         if(g < MAX_GROUPS && strchr(groups,*gp) == NULL)
+		 {
+		    groups[g++] = *gp;
+		    groups[g] = '\0';
+		 }
+	   }
+           else if(*idStnPt == '\0') // found first line
 	       *idStnPt = *line;  // get first character in the line
 	   else if(*destPt == '\0') // found second line
 	       *destPt = *line;  // get first character in the line
@@ -133,9 +159,16 @@ Description:
    the transmission of each message wait for an acknowledgement (note
    that ackFlag ensures that an acknowldegement has been received
    before transmitting the next message).
+   All messages received are processed before monitoring the ring again.
    When a message is received, print to the screen (using standard
    error) the message and send an acknowledgement to the source
-   of the message.
+   of the message (unless it was sent to a group address).
+   When dest is a group address, the acknowledgement comes from
+   the group and gives the number of members that got the message.
+   The Ack timer starts once the message has left txBuf.  The token
+   ring is never idle (the hub's rotation marker circulates), so
+   monitorTokenRing() returns regularly to check it.  A message whose
+   Ack is lost is received twice by its destination.
    The loop is broken when the standard input is closed (e.g.
    the write end of the pipe is closed) - this is detected by
    recvMessage().
@@ -148,43 +181,86 @@ void communication(char idStn, char dest, char *messages[])
    int ackFlag = TRUE;     // acknowledgement flag
    int flag;          // return flag from recvMessage()
    char source;            // source identificateur for received message/Ack
+   char msgDest;           // destination of received message (station or group)
+   int copies;             // number of stations that copied the message
    char msg[BUFSIZ];       // buffer for received message
+   long sentAt = 0;        // time the message waiting for an Ack was sent (ms)
+   int retries = 0;        // number of times it was sent again
 
    // loop for transmission and reception
    do
    {
-      // Message reception
-      flag = recvMessage(&source, msg); 
-      if(flag == MSG_EMPTY) /* do nothing */;  // no messages
-      else if(flag == MSG_RECV)  // Received a message
+      // Message reception - monitorTokenRing() may have received several
+      while((flag = recvMessage(&source, &msgDest, msg, &copies)) == MSG_RECV)
       {
          if(strcmp(msg,ACKNOWLEDGMENT) == 0) 
          {  // received the acknowledgment
             if(source == dest)
 	    {
 	       ackFlag = TRUE;   
-               fprintf(stderr,"Station %c (%d): Received from station %c an acknowledgement\n", 
-                       idStn, getpid(), source, msg);
+               if(IS_GROUP(source))
+                  fprintf(stderr,"Station %c (%d): Received from group %c an acknowledgement (%d copies)\n", 
+                          idStn, getpid(), source, copies);
+               else
+                  fprintf(stderr,"Station %c (%d): Received from station %c an acknowledgement\n", 
+                          idStn, getpid(), source, msg);
 	    }
 	    else fprintf(stderr, "Station %c (%d): received an Ack from %c - ignored\n",idStn,getpid(),source);
          } 
          else
          {     // Received a message - msg contains it, source gives id station that sent it
             fprintf(stderr,"Station %c (%d): Received from station %c >%s<\n", idStn, getpid(), source, msg);
-	    xmitMessage(source,ACKNOWLEDGMENT);
+	    if(!IS_GROUP(msgDest)) // group messages are acknowledged by the token ring module
+	       xmitMessage(source,ACKNOWLEDGMENT);
          }
       }
-      else // fatal or unknown error
+      if(flag != MSG_EMPTY) // fatal or unknown error
          fprintf(stderr,"Station %c (%d): unknown value returned by recvMessage (%d)\n",idStn,getpid(),flag);
 
+      // Retransmission - the message or its Ack was lost
+      if(!ackFlag && xmitPending())
+         sentAt = nowMs();           // still waiting for the token
+      else if(!ackFlag && nowMs() - sentAt > ACK_TIMEOUT_MS)
+      {
+         if(retries < ACK_RETRIES)
+         {
+            xmitMessage(dest,messages[i-1]);
+            fprintf(stderr,"Station %c (%d): No acknowledgement - sent again to %s %c >%s<\n",idStn,getpid(),
+                    IS_GROUP(dest) ? "group" : "station",dest,messages[i-1]);
+            retries++;
+            sentAt = nowMs();
+         }
+         else
+         {
+            fprintf(stderr,"Station %c (%d): No acknowledgement - gave up on >%s<\n",idStn,getpid(),messages[i-1]);
+            ackFlag = TRUE;          // go on with the next message
+         }
+      }
+
       // Transmission of messages 
       if(ackFlag && (messages[i] != NULL))
       {  // Send message
          xmitMessage(dest,messages[i]); 
-         fprintf(stderr,"Station %c (%d): Sent to station %c >%s<\n",idStn,getpid(),dest,messages[i]);
+         fprintf(stderr,"Station %c (%d): Sent to %s %c >%s<\n",idStn,getpid(),
+                 IS_GROUP(dest) ? "group" : "station",dest,messages[i]);
          ackFlag = FALSE;            // becomes TRUE at the arrival of an ack
 	 i++;                        // points to next message for next time
+         sentAt = nowMs();
+         retries = 0;
       }
       flag = monitorTokenRing();  
    } while(flag != FINISH); 
 }
+
+/*-------------------------------------------------------------
+Function: nowMs
+Description:
+   Returns a monotonic time in milliseconds.
+-------------------------------------------------------------*/
+long nowMs(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC,&ts);
+   return(ts.tv_sec*1000L + ts.tv_nsec/1000000L);
+}
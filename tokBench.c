@@ -0,0 +1,207 @@
+/*------------------------------------------------------------
+File: tokBench.c
+
+Description: Benchmark of the frame forwarding path of the token
+ring interface module (tokRing.c).  The module is run in this
+process with its standard input and standard output attached to
+pipes.  A feeder thread writes a mix of tokens and frames (for
+other stations, for this station, broadcast, and frames sent by
+this station) and a drain thread saves what the module writes.
+The number of system calls per frame is reported with and without
+batched I/O, for different numbers of frames written by the feeder
+at a time (the load).  The output of each batched run is compared
+with the output of the run with one write per frame, and the number
+of tokens and frames forwarded is checked; the program exits with
+status 1 if they differ.
+-------------------------------------------------------------*/
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include "tokRing.h"
+
+#define NUM_FRAMES 200000     // frames and tokens written by the feeder per run
+#define NUM_LOADS 4
+#define NUM_PATTERN 8
+#define OUT_SIZE (NUM_FRAMES*32)  // large enough for all the frames forwarded
+
+int loads[NUM_LOADS] = { 1, 4, 16, 64 };  // frames per write by the feeder
+// Frames written in turn by the feeder - the station is Z
+char *pattern[NUM_PATTERN] = {
+   "@YX-0Benchmark frame~",         // from X to Y - forwarded
+   "^",                             // token - forwarded (nothing to transmit)
+   "@YX-0Benchmark frame~",
+   "@ZX-0For station Z~",           // copied, copy count incremented
+   "@YX-0Benchmark frame~",
+   "@*X-0Broadcast~",               // copied, copy count incremented
+   "@XZ-0Sent by Z~",               // removed, replaced by the token
+   "@*Z-0Broadcast by Z~"           // removed, replaced by the token, aggregated Ack
+};
+
+// Output of a run, saved by drain()
+typedef struct
+{
+   char *buf;   // bytes written by the module
+   long len;    // number of bytes
+   int fd;      // fd to read from
+} Output;
+
+/* Prototypes */
+int runBench(int, int, Output *);
+void *feeder(void *);
+void *drain(void *);
+
+/*-------------------------------------------------------------
+Function: main
+Description:
+    Runs the benchmark for each load, with one write per frame
+    and with batched I/O, and prints the results.
+-------------------------------------------------------------*/
+int main(int ac, char **av)
+{
+   int ix;
+   int errors = 0;
+   Output single, batch;      // output of both modes
+
+   single.buf = malloc(OUT_SIZE);
+   batch.buf = malloc(OUT_SIZE);
+   initTokenRing('Z', "");
+   printf("%-8s %6s %10s %10s %10s %12s %10s %s\n",
+          "mode","load","frames","reads","writes","syscall/frm","ns/frm","output");
+   fflush(stdout);
+   for(ix = 0; ix < NUM_LOADS; ix++)
+   {
+      errors += runBench(0, loads[ix], &single);
+      errors += runBench(1, loads[ix], &batch);
+      if(batch.len != single.len || memcmp(batch.buf,single.buf,single.len) != 0)
+      {
+         printf("batched output differs from single output (load %d)\n",loads[ix]);
+         errors++;
+      }
+   }
+   free(single.buf);
+   free(batch.buf);
+   return(errors > 0);
+}
+
+/*-------------------------------------------------------------
+Function: runBench
+Parameters:
+    batch - 1 for batched I/O, 0 for one write per frame
+    load - number of frames per write by the feeder
+    output - to save the output of the run
+Description:
+    Attaches the standard input and output to pipes, runs
+    monitorTokenRing() until the feeder closes its pipe and
+    prints the statistics of the run.  Received messages are
+    removed from the module.  Returns 1 if the number of tokens
+    and frames forwarded is not NUM_FRAMES, 0 otherwise.
+-------------------------------------------------------------*/
+int runBench(int batch, int load, Output *output)
+{
+   int fdIn[2], fdOut[2];
+   int fdStdout;                 // saved standard output
+   int params[2];                // fd and load for the feeder
+   pthread_t tidFeed, tidDrain;
+   long reads0, writes0, frames0;
+   long reads, writes, frames;
+   struct timespec start, stop;
+   double ns;
+   char source, dest;            // for removing received messages
+   char msg[BUFSIZ];
+   int copies;
+   long ix, count;               // to count tokens and frames in the output
+
+   if(pipe(fdIn) == -1 || pipe(fdOut) == -1)
+   {
+      perror("tokBench: pipe");
+      exit(-1);
+   }
+   fdStdout = dup(1);
+   dup2(fdIn[0],0);
+   close(fdIn[0]);
+   dup2(fdOut[1],1);
+   close(fdOut[1]);
+
+   setBatchIO(batch);
+   tokRingStats(&reads0, &writes0, &frames0);
+   params[0] = fdIn[1];
+   params[1] = load;
+   clock_gettime(CLOCK_MONOTONIC,&start);
+   pthread_create(&tidFeed,NULL,feeder,params);
+   output->fd = fdOut[0];
+   output->len = 0;
+   pthread_create(&tidDrain,NULL,drain,output);
+   while(monitorTokenRing() != FINISH)
+      while(recvMessage(&source, &dest, msg, &copies) == MSG_RECV)
+         ;
+   clock_gettime(CLOCK_MONOTONIC,&stop);
+   pthread_join(tidFeed,NULL);
+   dup2(fdStdout,1);             // closes the write end - drain terminates
+   close(fdStdout);
+   pthread_join(tidDrain,NULL);
+   close(fdOut[0]);              // standard input is replaced in the next run
+
+   tokRingStats(&reads, &writes, &frames);
+   reads -= reads0;
+   writes -= writes0;
+   frames -= frames0;
+   ns = (stop.tv_sec - start.tv_sec)*1e9 + (stop.tv_nsec - start.tv_nsec);
+   for(ix = count = 0; ix < output->len; ix++)
+      if(output->buf[ix] == ETX || output->buf[ix] == SYN) count++;
+   printf("%-8s %6d %10ld %10ld %10ld %12.3f %10.0f %s\n",
+          batch ? "batch" : "single",load,frames,reads,writes,
+          (double) (reads+writes)/frames, ns/frames,
+          count == NUM_FRAMES ? "ok" : "WRONG COUNT");
+   fflush(stdout);
+   return(count != NUM_FRAMES);
+}
+
+/*-------------------------------------------------------------
+Function: feeder
+Description:
+    Thread that writes NUM_FRAMES frames (taken in turn from
+    pattern) to the pipe attached to the standard input of the
+    module, load frames per write, and then closes the pipe.
+-------------------------------------------------------------*/
+void *feeder(void *paramsPtr)
+{
+   int *params = (int *) paramsPtr;
+   int fd = params[0];
+   int load = params[1];
+   char buffer[BUFSIZ];
+   int len;
+   int sent, ix;
+
+   for(sent = 0; sent < NUM_FRAMES; )
+   {
+      len = 0;
+      for(ix = 0; ix < load && sent < NUM_FRAMES; ix++, sent++)
+      {
+         strcpy(buffer+len,pattern[sent % NUM_PATTERN]);
+         len += strlen(pattern[sent % NUM_PATTERN]);
+      }
+      write(fd,buffer,len);
+   }
+   close(fd);
+   return(NULL);
+}
+
+/*-------------------------------------------------------------
+Function: drain
+Description:
+    Thread that saves what the module writes in the output
+    buffer until the pipe is closed.
+-------------------------------------------------------------*/
+void *drain(void *outputPtr)
+{
+   Output *output = (Output *) outputPtr;
+   int num;
+
+   while(output->len < OUT_SIZE &&
+         (num = read(output->fd,output->buf+output->len,OUT_SIZE-output->len)) > 0)
+      output->len += num;
+   return(NULL);
+}
@@ -15,23 +15,33 @@ It monitors the network as follows:
 6) If the received frame source address is the station's address, 
    write the token on the T-pair pipe.
 7) If the destination address of a received frame is the station's 
-   address, the frame is written to rxBuf.
+   address, the frame is written to rxBuf.  The same is done for
+   a group address the station is a member of (or BROADCAST); each
+   station copying the frame increments its copy count.
+8) When a frame sent to a group address returns to its source, an
+   acknowledgement carrying the copy count is written to rxBuf (a
+   single aggregated Ack instead of one Ack per member).
+9) The monitor mark of retransmitted frames is preserved so that the
+   active monitor in the hub can recognize orphan frames (frames that
+   pass it a second time because no station removed them).
+10) When the rotation marker of the active monitor passes (a frame
+   addressed to MONITOR_ID), monitorTokenRing() returns so that the
+   station can check its timers even when it receives nothing.
+In batched I/O mode (the default, see monitorBatch()), all frames
+obtained by one read are forwarded with a single writev instead of
+one write per frame.
 The standard error can be used to write messages to screen.
 -------------------------------------------------------------*/
 #include <stdio.h>
 #include <unistd.h>
+#include <sys/uio.h>
+#include <limits.h>
 #include "tokRing.h"
 #include <string.h>
 
-// Some definitions
-// for frames
-#define SYN '^'       // SYN character - the Token
-#define STX '@'       // Start of the frame - start of Xmission
-#define ETX '~'       // End of the frame - end of Xmission
-#define STX_POS 0     // Position of STX
-#define DST_POS 1     // Position of the destination identifier
-#define SRC_POS 2     // Position of the source identifier
-#define MSG_POS 4     // Position of the frame
+#ifndef IOV_MAX
+#define IOV_MAX 1024  // Maximum number of entries for writev
+#endif
 
 //********************** Global variables *****************/
 // Message Buffers - Set large enough not to worry about overflow
@@ -42,26 +52,44 @@ The standard error can be used to write messages to screen.
 //     Can use strcat() to append a frame to the buffer.
 char rxBuf[2*BUFSIZ];  
 char txBuf[2*BUFSIZ];  
+// All frames read from the pipe (see readFrames())
+char allFrames[BUFSIZ];
 // This station Identifier
 char  stnId;
+// Group addresses the station is a member of
+char  groups[MAX_GROUPS+1];
+// Batched I/O
+int   batchIO = 1;   // forward frames with monitorBatch()
+// I/O statistics
+long  statReads = 0;   // read system calls
+long  statWrites = 0;  // write/writev system calls
+long  statFrames = 0;  // frames and tokens forwarded
 /*****************************/
 
 // Local Function Prototypes
-int readMsg(char *, char *, char *);
-int extractMsg(char *, char *, char *, char *);
+int readMsg(char *, char *, char *, char *, char *);
+int readFrames(void);
+int extractMsg(char *, char *, char *, char *, char *, char *);
+int isMember(char);
+int monitorBatch(void);
+int buildFrame(char *, char, char, char, char, char *);
+void addIov(struct iovec *, int *, char *, int);
 
 /*-------------------------------------------------------------
 Function: initTokenRing
 Parameters: int id - Station identifier.
+            char *grps - group addresses the station is a member of.
 Returns: Nothing.
 Description:
    Sets up the global variables.
 -------------------------------------------------------------*/
-void initTokenRing(int id)
+void initTokenRing(int id, char *grps)
 {
    int tid;
 
    stnId = id;  // The station identifier
+   strncpy(groups, grps, MAX_GROUPS);
+   groups[MAX_GROUPS] = '\0';
    // Ensure buffers are empty
    // Ensure buffers are empty
    rxBuf[0] = '\0';
@@ -70,7 +98,7 @@ void initTokenRing(int id)
 
 /*-------------------------------------------------------------
 Function: xmitMessage
-Parameters: char dest - destination of message 
+Parameters: char dest - destination of message (station or group address)
             char *msg - message string to send
 Returns: nothing
 Description:
@@ -79,31 +107,56 @@ Description:
 void xmitMessage(char dest, char *msg)
 {
     char frame[BUFSIZ];
-    sprintf(frame,"%c%c%c-%s%c",STX,stnId,dest,msg,ETX); // create frame
+    sprintf(frame,"%c%c%c%c%c%s%c",STX,stnId,dest,MON_CLR,CPY_NONE,msg,ETX); // create frame
     strcat(txBuf, frame);
 }
 
+/*-------------------------------------------------------------
+Function: xmitPending
+Parameters: none
+Returns: 1 if frames are waiting for the token in txBuf, 0 otherwise
+Description:
+   Tells whether the messages given to xmitMessage() have all been
+   transmitted.
+-------------------------------------------------------------*/
+int xmitPending()
+{
+    return(txBuf[0] != '\0');
+}
+
 /*-------------------------------------------------------------
 Function: recvMessage
 Parameters: char *source - for returning the source
+            char *dest - for returning the destination (the station
+                         or a group address)
             char *msg - message string 
+            int *copies - for returning the number of stations that
+                          copied the frame; for an aggregated Ack, the
+                          number of group members that received it
 Returns: Return value from extractMsg which can be
            MSG_EMPTY - buffer is empty.
            MSG_RECV - message was found.
 Description:
     Remove a frame from rxBuf if possible.
+    An aggregated Ack has the group address as source.
 -------------------------------------------------------------*/
-int recvMessage(char *source, char *msg)
+int recvMessage(char *source, char *dest, char *msg, int *copies)
 {
-    char dest;
-    return(extractMsg(rxBuf,msg,source,&dest));
+    char mon;
+    char cpy;
+    int ret;
+
+    ret = extractMsg(rxBuf,msg,source,dest,&mon,&cpy);
+    *copies = cpy - CPY_NONE;
+    return(ret);
 }
 
 /*-------------------------------------------------------------
 Function: monitorTokenRing
 Parameters: none
 Returns:  FINISH - link to LAN broken, MSG_STN - message
-          has been received for the station.
+          has been received for the station, MSG_ROT - the
+          rotation marker passed.
 Description:
    Monitors the token ring LAN as described at the beginning
    of this file.
@@ -113,10 +166,13 @@ Description:
    readMsg(). In this case the function returns.
 
    The function returns when a message destined for the station
-   is received, i.e. the rxBuf has been updated.  
+   is received, i.e. the rxBuf has been updated, or when the
+   rotation marker of the active monitor passes.
 
    Note that readMsg() blocks when the pipe attached to 
    the standard input is empty.
+
+   In batched I/O mode, monitorBatch() is used instead.
 -------------------------------------------------------------*/
 int monitorTokenRing()
 {
@@ -124,45 +180,67 @@ int monitorTokenRing()
    int flag;               // return flag from readMsg()
    char source;            // source identifier for received message/Ack
    char dest;              // dest identifier for received message/Ack
+   char mon;               // monitor mark of received message/Ack
+   char cpy;               // copy count of received message/Ack
    char msg[BUFSIZ];       // buffer for received message
    char frame[BUFSIZ];     // for building frames
 
+   if(batchIO) return(monitorBatch());
+
    // loop that monitors network
    // readMsg blocks when pipe is empty.
    // flag set to FINISH by readMsg when pipe is closed
    do
    {
-      flag = readMsg(msg, &source, &dest);
+      flag = readMsg(msg, &source, &dest, &mon, &cpy);
       // Transmitting message
       if(flag == MSG_TOK) // token was received - note msg, source, and dest are meaningless
       {  
-         if(extractMsg(txBuf,msg,&source,&dest) == MSG_EMPTY)  // no frames to Xmit
+         if(extractMsg(txBuf,msg,&source,&dest,&mon,&cpy) == MSG_EMPTY)  // no frames to Xmit
             sprintf(frame,"%c",SYN);
 	 else
-            sprintf(frame,"%c%c%c-%s%c",STX,source,dest,msg,ETX); // create frame
+            sprintf(frame,"%c%c%c%c%c%s%c",STX,source,dest,MON_CLR,CPY_NONE,msg,ETX); // create frame
          write(1,frame,strlen(frame));   // writes to the standard output, i.e. pipe
+         statWrites++;
+         statFrames++;
       }
       // Reception de messages 
       else if(flag == MSG_RECV) 
       {     // Received a message - msg contains it, source gives id station that sent it
          if(source == stnId) // frame sent by this station - need to release token
+	 {
+            if(IS_GROUP(dest)) // aggregated Ack from the group members
+            {
+               sprintf(frame,"%c%c%c%c%c%s%c",STX,stnId,dest,MON_CLR,cpy,ACKNOWLEDGMENT,ETX);
+	       strcat(rxBuf, frame);
+	       flag = MSG_STN;
+            }
             sprintf(frame,"%c",SYN);
+	 }
 	 else 
 	 {
-             sprintf(frame,"%c%c%c-%s%c",STX,dest,source,msg,ETX); // create frame
-	     if(dest == stnId) 
+	     if(dest == stnId || isMember(dest)) 
              { 
+               cpy++;  // one more station copied the frame
+               sprintf(frame,"%c%c%c%c%c%s%c",STX,dest,source,mon,cpy,msg,ETX); // create frame
 	       strcat(rxBuf, frame);  // save copy if for this station
 	       flag = MSG_STN;  // To return so that received message can be processed
              } 
+             else
+             {
+               sprintf(frame,"%c%c%c%c%c%s%c",STX,dest,source,mon,cpy,msg,ETX); // create frame, keep monitor mark
+               if(dest == MONITOR_ID) flag = MSG_ROT;  // rotation marker - return to the station
+             }
 	 }
          write(1,frame,strlen(frame));
+         statWrites++;
+         statFrames++;
       }
       else if(flag == FINISH) /* do nothing */;
       else // fatal or unknown error
          fprintf(stderr,"Station %c (%d): unknown value returned by readMsg (%d)\n",stnId,getpid(),flag);
 
-   } while( (flag != FINISH) && (flag != MSG_STN));
+   } while( (flag != FINISH) && (flag != MSG_STN) && (flag != MSG_ROT));
 
    return(flag);
 }
@@ -173,11 +251,12 @@ Parameters:
 	msg	  - pointer to buffer for storing received message (frame contents)
 	sourcePtr - pointer to a character to receive source identifier
 	destPtr   - pointer to a character to receive destination identifier
+	monPtr    - pointer to a character to receive the monitor mark
+	cpyPtr    - pointer to a character to receive the copy count
 Description:
     Reads one or more frames from the standard input (i.e. pipe) and stores
-    them in buffer (allframes).  If the standard input is closed, return FINISH. 
-    Note that the buffer allFrames is static and does not disappear between calls
-    to the function.
+    them in buffer (allframes) using readFrames().  If the standard input is
+    closed, return FINISH. 
 
     If frames have been received, call extractMsg() to extract the
     first message; it returns MSG_TOK if a token is found or
@@ -192,34 +271,24 @@ Description:
 
     See extractMsg() for frame format.
 -------------------------------------------------------------*/
-int readMsg(char *msg, char *sourcePtr, char *destPtr)
+int readMsg(char *msg, char *sourcePtr, char *destPtr, char *monPtr, char *cpyPtr)
 {
-   static char allFrames[BUFSIZ];  // all frames read from pipe - static buffer
    int ret;			   // value returned by this function
    int retRead;			   // to store value returned by read and extractMsg function
-   char errorMsg[BUFSIZ];         // buffer to build error messages
    
    while(1) // Loop to find a message
    {
       if(*allFrames == '\0') // buffer empty - need to read from the pipe
       {
-        retRead = read(0,allFrames,BUFSIZ-1); // blocks when pipe is empty
-	if(retRead == -1) 
-	{
-            sprintf(errorMsg,"Station %c (%d): reading error",errorMsg,stnId);
-            perror(errorMsg);
-	}
-	else if(retRead == 0) // write end of pipe has been closed
+        if(readFrames() == 0) // write end of pipe has been closed
 	{
 	    ret = FINISH;
 	    break;  // break out of loop
 	}
-	// messages are in the buffer
-	allFrames[retRead]='\0';  // terminate the string
       }
       // The following line can be used for debugging
       //fprintf(stderr,"Station %c (%d): readMsg >%s<\n", stnId, getpid(), toutesTrames);
-      retRead = extractMsg(allFrames, msg, sourcePtr, destPtr);
+      retRead = extractMsg(allFrames, msg, sourcePtr, destPtr, monPtr, cpyPtr);
       if(retRead != MSG_EMPTY) // if MSG_EMPTY, no messages were found in the buffer 
       {
           ret = retRead;  // is MSG_TOK or MSG_RECV
@@ -230,6 +299,60 @@ int readMsg(char *msg, char *sourcePtr, char *destPtr)
    return(ret);
 }
 
+/*-------------------------------------------------------------
+Function: readFrames
+Parameters: none
+Returns: value returned by read: number of bytes read, 0 if the
+         standard input is closed or -1 on error.
+Description:
+    Reads frames from the standard input (i.e. pipe) into allFrames
+    (which must be empty) and terminates the string.  Blocks when the
+    pipe is empty.  A frame at the end of allFrames without its ETX was
+    cut by the read; it is held back and placed at the start of
+    allFrames on the next call.  A frame followed by a token has lost
+    its tail instead: it is not held back, so that the token is always
+    forwarded.  A frame too long to fit in allFrames is discarded.
+-------------------------------------------------------------*/
+int readFrames()
+{
+   static char held[BUFSIZ];      // frame cut by the last read
+   static int heldLen = 0;        // length of the frame in held
+   static char ends[] = { ETX, SYN, '\0' };  // characters after a complete or truncated frame
+   int retRead;			   // value returned by read
+   int len;                       // length of allFrames
+   char *tail;                    // last frame in allFrames
+   char errorMsg[BUFSIZ];         // buffer to build error messages
+
+   memcpy(allFrames,held,heldLen);
+   retRead = read(0,allFrames+heldLen,BUFSIZ-1-heldLen); // blocks when pipe is empty
+   statReads++;
+   if(retRead == -1) 
+   {
+      sprintf(errorMsg,"Station %c (%d): reading error",stnId,getpid());
+      perror(errorMsg);
+      *allFrames = '\0';
+   }
+   else if(retRead > 0)
+   {
+      len = heldLen + retRead;
+      allFrames[len]='\0';  // terminate the string
+      heldLen = 0;
+      tail = strrchr(allFrames,STX);
+      if(tail != NULL && strpbrk(tail,ends) == NULL) // last frame was cut
+      {
+         if(tail == allFrames && len == BUFSIZ-1)
+            fprintf(stderr,"stn(%c,%d): frame too long: >%.20s...<\n",stnId,getpid(),tail);
+         else
+         {
+            heldLen = strlen(tail);
+            memcpy(held,tail,heldLen);
+         }
+         *tail = '\0';
+      }
+   }
+   return(retRead);
+}
+
 /*------------------------------------------------
 Function: extractMsg
 
@@ -238,22 +361,30 @@ Parameters:
     msg		- points to buffer to receive a message
     sourcePtr   - to return the identifier of the source 
     destPtr     - to return the identifier of the destination 
+    monPtr      - to return the monitor mark (MON_CLR or MON_SET)
+    cpyPtr      - to return the copy count (CPY_NONE plus number of copies)
 
 Description: 
      Extracts a message from the buffer referenced by frameBuf.
      The message is removed and copied to the buffer referenced
      by msg. Frames with improper destination id are skipped.
 
-     Message format: STX D S <message> ETX
+     Message format: STX D S M C <message> ETX
                      SYN - the token
-     D gives the ident. of the destination station. 
+     D gives the ident. of the destination station or group. 
      S gives the ident. of the station that sent the message 
-     <message> - string of characters
+     M is the monitor mark set by the active monitor (hub)
+     C is the number of stations that copied the frame ('0' to '9')
+     <message> - string of characters (no STX, ETX or SYN)
      If STX is missing, print an error and skip the message.
+     If the next frame or the token comes before the ETX, the
+     frame lost its tail; print an error and skip it.
 ------------------------------------------------*/
-int extractMsg(char *frameBuf, char *msg, char *sourcePtr, char *destPtr)
+int extractMsg(char *frameBuf, char *msg, char *sourcePtr, char *destPtr, char *monPtr, char *cpyPtr)
 {
+   static char stops[] = { STX, ETX, SYN, '\0' };  // characters ending a frame
    char *pt=frameBuf;       // pointer to navigate the buffer of all frames
+   char *end;               // end of a frame
    int retcd = MSG_EMPTY;  // return value 
 
    while(1) // find a message for this station
@@ -268,27 +399,258 @@ int extractMsg(char *frameBuf, char *msg, char *sourcePtr, char *destPtr)
       {
          retcd = MSG_TOK;
 	 pt++;                    // skip the SYN
-	 strcpy(frameBuf,pt);      // move unread frames to the start of the buffer
+	 memmove(frameBuf,pt,strlen(pt)+1); // move unread frames to the start of the buffer
 	 break;
       }
       else if(*pt != STX) // found an error - no STX
       {
 	  fprintf(stderr,"stn(%c,%d): no STX: >%s<\n",stnId,getpid(),pt);
-          while(*pt != ETX && *pt != STX && *pt != '\0') pt++;  // skip until the end or beginning 
+          while(*pt != ETX && *pt != STX && *pt != SYN && *pt != '\0') pt++;  // skip until the end, beginning or token
 	  if(*pt == ETX) pt++; 					// skip the ETX
       }
+      else if((end = strpbrk(pt+1,stops)) != NULL && *end != ETX) // frame lost its tail
+      {
+         fprintf(stderr,"stn(%c,%d): no ETX: >%.*s<\n",stnId,getpid(),(int) (end-pt),pt);
+         pt = end;  // the next frame or the token
+      }
       else // found a message
       {
          *sourcePtr = *(pt+SRC_POS);                       // to return the source ident.
          *destPtr = *(pt+DST_POS);                         // to return the destination ident.
+         *monPtr = *(pt+MON_POS);                          // to return the monitor mark
+         *cpyPtr = *(pt+CPY_POS);                          // to return the copy count
          retcd = MSG_RECV;
 	 pt = pt+MSG_POS;                                  // point to the message
          while(*pt != ETX && *pt != '\0') *msg++ = *pt++;  // copy message into buffer
 	 if(*pt == ETX) pt++;                              // skip the ETX
 	 *msg = '\0';                                      // terminate the string
-	 strcpy(frameBuf,pt);                               // move unread frames to the start of the buffer
+	 memmove(frameBuf,pt,strlen(pt)+1);                 // move unread frames to the start of the buffer
 	 break;
       }
    }
    return(retcd);
 }
+
+/*------------------------------------------------
+Function: isMember
+
+Parameters:
+    dest 	- destination identifier of a frame
+
+Description: 
+     Returns 1 if dest is BROADCAST or a group address the
+     station is a member of, 0 otherwise.
+------------------------------------------------*/
+int isMember(char dest)
+{
+   if(dest == BROADCAST) return(1);
+   return(IS_GROUP(dest) && strchr(groups,dest) != NULL);
+}
+
+/*-------------------------------------------------------------
+Function: setBatchIO
+Parameters: int on - 1 to use batched I/O, 0 for one write per frame
+Returns: nothing
+Description:
+   Selects how monitorTokenRing() forwards frames.  Batched I/O
+   is used by default.
+-------------------------------------------------------------*/
+void setBatchIO(int on)
+{
+   batchIO = on;
+}
+
+/*-------------------------------------------------------------
+Function: tokRingStats
+Parameters: long *reads - for returning the number of reads
+            long *writes - for returning the number of writes/writevs
+            long *frames - for returning the number of frames forwarded
+Returns: nothing
+Description:
+   Returns the I/O statistics of the module since it was started.
+-------------------------------------------------------------*/
+void tokRingStats(long *reads, long *writes, long *frames)
+{
+   *reads = statReads;
+   *writes = statWrites;
+   *frames = statFrames;
+}
+
+/*-------------------------------------------------------------
+Function: monitorBatch
+Parameters: none
+Returns:  FINISH - link to LAN broken, MSG_STN - message
+          has been received for the station, MSG_ROT - the
+          rotation marker passed.
+Description:
+   Same as monitorTokenRing() but frames are processed directly
+   in allFrames: frames that are retransmitted unchanged (apart
+   from the copy count) are not copied, and all the frames obtained
+   by one read are written with a single writev (or more only if
+   IOV_MAX entries are needed).  Contiguous frames share one entry
+   in the iovec array.
+
+   The size of a batch follows the load: under light load a read
+   holds one frame, which is forwarded at once; under heavy load
+   all the frames waiting in the pipe share one system call.
+   The function never waits for more frames.
+
+   The function returns after the frames of a read have been
+   forwarded if a message for the station was copied to rxBuf (more
+   than one message may have been copied).
+-------------------------------------------------------------*/
+int monitorBatch()
+{
+   static char syn = SYN;       // the token
+   static char stops[] = { STX, ETX, SYN, '\0' };  // characters ending a frame
+   struct iovec iov[IOV_MAX];   // frames of the batch
+   int nIov;                    // number of entries in iov
+   int nFrames;                 // number of frames in the batch
+   char outBuf[2*BUFSIZ];       // frames built for the batch (from txBuf)
+   int outLen;                  // number of bytes in outBuf
+   int flag = 0;                // FINISH or MSG_STN when done
+   int len;                     // length of a frame
+   int rxLen;                   // length of rxBuf
+   char *pt, *end;              // to navigate allFrames
+   char source;                 // source identifier of a frame
+   char dest;                   // dest identifier of a frame
+   char mon;                    // monitor mark of a frame from txBuf
+   char cpy;                    // copy count of a frame from txBuf
+   char msg[BUFSIZ];            // message of a frame from txBuf
+
+   while(flag == 0)
+   {
+      if(*allFrames == '\0' && readFrames() == 0) return(FINISH);  // write end of pipe has been closed
+      nIov = 0;
+      nFrames = 0;
+      outLen = 0;
+      pt = allFrames;
+      while(*pt != '\0')
+      {
+         if(nIov == IOV_MAX) // iovec array full
+         {
+            writev(1,iov,nIov);
+            statWrites++;
+            nIov = 0;
+         }
+         if(*pt == SYN) // token was received
+         {
+            if(extractMsg(txBuf,msg,&source,&dest,&mon,&cpy) == MSG_EMPTY)  // no frames to Xmit
+               addIov(iov,&nIov,pt,1);
+            else
+            {
+               len = buildFrame(outBuf+outLen,source,dest,MON_CLR,CPY_NONE,msg);
+               addIov(iov,&nIov,outBuf+outLen,len);
+               outLen += len;
+            }
+            pt++;
+            nFrames++;
+         }
+         else if(*pt != STX) // found an error - no STX
+         {
+            fprintf(stderr,"stn(%c,%d): no STX: >%s<\n",stnId,getpid(),pt);
+            while(*pt != ETX && *pt != STX && *pt != SYN && *pt != '\0') pt++;  // skip until the end, beginning or token
+            if(*pt == ETX) pt++;                                 // skip the ETX
+         }
+         else // found a frame
+         {
+            end = strpbrk(pt+1,stops);  // readFrames() ensures there is an ETX or SYN after the last STX
+            if(end == NULL) end = pt+strlen(pt);
+            if(*end != ETX) // frame cut - the next frame or the token comes before its ETX
+            {
+               fprintf(stderr,"stn(%c,%d): no ETX: >%.*s<\n",stnId,getpid(),(int) (end-pt),pt);
+               pt = end;
+               continue;
+            }
+            len = end-pt+1;
+            if(len <= MSG_POS) // too short to hold the header
+            {
+               fprintf(stderr,"stn(%c,%d): short frame: >%.*s<\n",stnId,getpid(),len,pt);
+               pt += len;
+               continue;
+            }
+            source = pt[SRC_POS];
+            dest = pt[DST_POS];
+            if(source == stnId) // frame sent by this station - need to release token
+            {
+               if(IS_GROUP(dest)) // aggregated Ack from the group members
+               {
+                  rxLen = strlen(rxBuf);
+                  buildFrame(rxBuf+rxLen,stnId,dest,MON_CLR,pt[CPY_POS],ACKNOWLEDGMENT);
+                  flag = MSG_STN;
+               }
+               addIov(iov,&nIov,&syn,1);
+            }
+            else
+            {
+               if(dest == stnId || isMember(dest))
+               {
+                  pt[CPY_POS]++;  // one more station copied the frame
+                  strncat(rxBuf,pt,len);  // save copy if for this station
+                  flag = MSG_STN;  // To return so that received message can be processed
+               }
+               else if(dest == MONITOR_ID && flag == 0)
+                  flag = MSG_ROT;  // rotation marker - return to the station
+               addIov(iov,&nIov,pt,len);  // retransmit the frame as is
+            }
+            pt += len;
+            nFrames++;
+         }
+      }
+      if(nIov > 0)
+      {
+         writev(1,iov,nIov);  // writes to the standard output, i.e. pipe
+         statWrites++;
+      }
+      statFrames += nFrames;
+      *allFrames = '\0';  // all frames processed
+   }
+   return(flag);
+}
+
+/*-------------------------------------------------------------
+Function: buildFrame
+Parameters: char *frame - buffer for the frame
+            char dest, source, mon, cpy - the frame header
+            char *msg - the message
+Returns: length of the frame
+Description:
+   Builds a frame (STX D S M C <message> ETX) in the buffer
+   referenced by frame and terminates the string.
+-------------------------------------------------------------*/
+int buildFrame(char *frame, char dest, char source, char mon, char cpy, char *msg)
+{
+   int len = strlen(msg);
+
+   frame[STX_POS] = STX;
+   frame[DST_POS] = dest;
+   frame[SRC_POS] = source;
+   frame[MON_POS] = mon;
+   frame[CPY_POS] = cpy;
+   memcpy(frame+MSG_POS,msg,len);
+   frame[MSG_POS+len] = ETX;
+   frame[MSG_POS+len+1] = '\0';
+   return(MSG_POS+len+1);
+}
+
+/*-------------------------------------------------------------
+Function: addIov
+Parameters: struct iovec *iov - the iovec array
+            int *nIov - number of entries in iov
+            char *base, int len - the bytes to add
+Returns: nothing
+Description:
+   Adds bytes to be written by writev.  When they follow the
+   bytes of the last entry in memory, that entry is extended.
+-------------------------------------------------------------*/
+void addIov(struct iovec *iov, int *nIov, char *base, int len)
+{
+   if(*nIov > 0 && (char *) iov[*nIov-1].iov_base + iov[*nIov-1].iov_len == base)
+      iov[*nIov-1].iov_len += len;
+   else
+   {
+      iov[*nIov].iov_base = base;
+      iov[*nIov].iov_len = len;
+      (*nIov)++;
+   }
+}
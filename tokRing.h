@@ -11,11 +11,36 @@ Description: Header file for token ring interface
 #define MSG_EMPTY 3
 #define MSG_RECV 4
 #define MSG_STN 5   
+#define MSG_ROT 6   // rotation marker of the active monitor passed - no message
+#define ACKNOWLEDGMENT "Ack"
+
+// Frame format (shared with the hub's active monitor)
+#define SYN '^'       // SYN character - the Token
+#define STX '@'       // Start of the frame - start of Xmission
+#define ETX '~'       // End of the frame - end of Xmission
+#define STX_POS 0     // Position of STX
+#define DST_POS 1     // Position of the destination identifier
+#define SRC_POS 2     // Position of the source identifier
+#define MON_POS 3     // Position of the monitor mark
+#define CPY_POS 4     // Position of the copy count
+#define MSG_POS 5     // Position of the frame
+#define MON_CLR '-'   // Monitor mark - frame has not yet passed the active monitor
+#define MON_SET '#'   // Monitor mark - frame has passed the active monitor once (not BROADCAST)
+#define MONITOR_ID '!' // Address of the active monitor (hub) - its rotation marker frames
+#define CPY_NONE '0'  // Copy count - no station has copied the frame yet
+#define MAX_GROUPS 10 // Group addresses are '0' to '9'
+
+// Group destination addresses - the frame is copied by every member station
+#define BROADCAST '*' // All stations are members
+#define IS_GROUP(id) ((id) == BROADCAST || ((id) >= '0' && (id) <= '9'))
 
 // Prototypes
-void initTokenRing(int);
+void initTokenRing(int, char *);
 void xmitMessage(char, char *);
-int recvMessage(char *, char *);
+int xmitPending(void);
+int recvMessage(char *, char *, char *, int *);
 int monitorTokenRing(void);
+void setBatchIO(int);
+void tokRingStats(long *, long *, long *);
 
 